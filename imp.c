@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include "object.h"
+#include "vector.h"
 
 
 static int debug = 0;
@@ -36,6 +37,13 @@ static jit_value_t emit_malloc(jit_function_t function, int size) {
     return jit_insn_call_native (function, "malloc", (void *)malloc, signature, args, 1, 0);
 }
 
+static jit_value_t emit_native(jit_function_t function, const char *name,
+                               void *native, jit_value_t *args, int nargs,
+                               int flags) {
+    return jit_insn_call_native(function, name, native, fn_signature(nargs),
+                                args, nargs, flags);
+}
+
 /**
  * Extends the lexical environment for a new fn by adding the end of
  * frame marker and a list of parameters bound to jit param values.
@@ -136,7 +144,9 @@ static jit_value_t emit_closure(jit_function_t fn, imp_object env,
 
 static jit_value_t emit_fixnum2int(jit_function_t fn, jit_value_t fixnum) {
    jit_value_t one = jit_value_create_nint_constant(fn, jit_type_nint, 1);
-   return jit_insn_shr(fn, fixnum, one);
+   // convert first so that the shift is signed
+   jit_value_t value = jit_insn_convert(fn, fixnum, jit_type_nint, 0);
+   return jit_insn_shr(fn, value, one);
 }
 
 static jit_value_t emit_int2fixnum(jit_function_t fn, jit_value_t fixnum) {
@@ -171,6 +181,179 @@ static jit_value_t emit_binop(jit_function_t fn, imp_object env,
     return emit_int2fixnum(fn, result);
 }
 
+static imp_object native_nth(imp_object coll, imp_object idx) {
+    return imp_nth(coll, imp_cint(idx));
+}
+
+static imp_object native_count(imp_object coll) {
+    return imp_fixnum(imp_count(coll));
+}
+
+/**
+ * Copies value into a new function-wide value, for values that are used
+ * on the other side of a branch.
+ */
+static jit_value_t emit_local(jit_function_t fn, jit_type_t type,
+                              jit_value_t value) {
+    jit_value_t local = jit_value_create(fn, type);
+    jit_insn_store(fn, local, value);
+    return local;
+}
+
+/**
+ * Emits code that constructs a vector from the values of its arguments.
+ * An ivector stores them unboxed.
+ *
+ *     +---------------------+
+ *     | type tag (I)VECTOR  | int
+ *     +---------------------+
+ *     | count               | int64
+ *     +---------------------+
+ *     | item 0              | pointer or int64
+ *     +---------------------+
+ *                :
+ *     +---------------------+
+ *     | item N-1            | pointer or int64
+ *     +---------------------+
+ */
+static jit_value_t emit_vector(jit_function_t fn, imp_object env,
+                               imp_object form, imp_object *enclosed) {
+    int unboxed = !strcmp(imp_symbol_cstr(imp_first(form)), "ivector");
+    int count = imp_count(imp_rest(form));
+    int offset = offsetof(imp_object_struct, fields.vector.items);
+    // elements may branch, so obj must outlive the current block
+    jit_value_t obj = emit_local(fn, jit_type_void_ptr,
+                                 emit_malloc(fn, offset + sizeof(void*) * count));
+
+    jit_value_t tag = jit_value_create_nint_constant(fn, jit_type_int,
+                                                     unboxed ? IVECTOR : VECTOR);
+    jit_insn_store_relative(fn, obj, offsetof(imp_object_struct, type), tag);
+    jit_value_t countc = jit_value_create_long_constant(fn, jit_type_long, count);
+    jit_insn_store_relative(fn, obj, offsetof(imp_object_struct,
+                                              fields.vector.count), countc);
+
+    for (imp_object it = imp_rest(form); it != NULL; it = imp_rest(it)) {
+        // XXX type checking
+        jit_value_t value = compile(env, fn, imp_first(it), enclosed);
+        if (unboxed)
+            value = emit_fixnum2int(fn, value);
+        jit_insn_store_relative(fn, obj, offset, value);
+        offset += sizeof(void*);
+    }
+    return obj;
+}
+
+static jit_value_t emit_load_tag(jit_function_t fn, jit_value_t obj) {
+    return jit_insn_load_relative(fn, obj, offsetof(imp_object_struct, type),
+                                  jit_type_int);
+}
+
+/**
+ * Emits a check that obj is a vector or ivector, branching to notvector
+ * if it is anything else.
+ */
+static void emit_vector_guard(jit_function_t fn, jit_value_t obj,
+                              jit_label_t *notvector) {
+    jit_value_t one = jit_value_create_nint_constant(fn, jit_type_nint, 1);
+    jit_insn_branch_if_not(fn, obj, notvector);
+    jit_insn_branch_if(fn, jit_insn_and(fn, obj, one), notvector);
+    jit_value_t tag = emit_load_tag(fn, obj);
+    jit_value_t vectortag = jit_value_create_nint_constant(fn, jit_type_int, VECTOR);
+    jit_value_t ivectortag = jit_value_create_nint_constant(fn, jit_type_int, IVECTOR);
+    jit_value_t isvector = jit_insn_or(fn, jit_insn_eq(fn, tag, vectortag),
+                                       jit_insn_eq(fn, tag, ivectortag));
+    jit_insn_branch_if_not(fn, isvector, notvector);
+}
+
+/**
+ * Emits an inline, bounds-checked element load. Vectors and ivectors
+ * share a layout so the element is loaded the same way for both and an
+ * ivector element is then tagged as a fixnum.
+ *
+ * Lists and out of range indexes go through imp_nth, which reports the
+ * error.
+ */
+static jit_value_t emit_nth(jit_function_t fn, imp_object env,
+                            imp_object form, imp_object *enclosed) {
+    jit_label_t slowlabel = jit_label_undefined;
+    jit_label_t endlabel = jit_label_undefined;
+    jit_value_t args[2];
+    args[0] = emit_local(fn, jit_type_void_ptr,
+                         compile(env, fn, imp_second(form), enclosed));
+    args[1] = emit_local(fn, jit_type_void_ptr,
+                         compile(env, fn, imp_third(form), enclosed));
+    jit_value_t result = jit_value_create(fn, jit_type_void_ptr);
+    emit_vector_guard(fn, args[0], &slowlabel);
+
+    // unsigned compare so negative indexes fail the check too
+    jit_value_t index = emit_local(fn, jit_type_nuint,
+                                   emit_fixnum2int(fn, args[1]));
+    jit_value_t count = jit_insn_load_relative(fn, args[0],
+                                               offsetof(imp_object_struct,
+                                                        fields.vector.count),
+                                               jit_type_nuint);
+    jit_insn_branch_if_not(fn, jit_insn_lt(fn, index, count), &slowlabel);
+    jit_value_t items = jit_insn_add_relative(fn, args[0],
+                                              offsetof(imp_object_struct,
+                                                       fields.vector.items));
+    jit_insn_store(fn, result, jit_insn_load_elem(fn, items, index, jit_type_nint));
+    jit_value_t ivectortag = jit_value_create_nint_constant(fn, jit_type_int, IVECTOR);
+    jit_value_t isivector = jit_insn_eq(fn, emit_load_tag(fn, args[0]), ivectortag);
+    jit_insn_branch_if_not(fn, isivector, &endlabel);
+    jit_insn_store(fn, result, emit_int2fixnum(fn, result));
+    jit_insn_branch(fn, &endlabel);
+
+    jit_insn_label(fn, &slowlabel);
+    jit_insn_store(fn, result, emit_native(fn, "native_nth", (void *)native_nth,
+                                           args, 2, 0));
+    jit_insn_label(fn, &endlabel);
+    return result;
+}
+
+/**
+ * Emits an inline count for vectors. Lists go through imp_count.
+ */
+static jit_value_t emit_count(jit_function_t fn, imp_object env,
+                              imp_object form, imp_object *enclosed) {
+    jit_label_t slowlabel = jit_label_undefined;
+    jit_label_t endlabel = jit_label_undefined;
+    jit_value_t coll = emit_local(fn, jit_type_void_ptr,
+                                  compile(env, fn, imp_second(form), enclosed));
+    jit_value_t result = jit_value_create(fn, jit_type_void_ptr);
+    emit_vector_guard(fn, coll, &slowlabel);
+
+    jit_value_t count = jit_insn_load_relative(fn, coll,
+                                               offsetof(imp_object_struct,
+                                                        fields.vector.count),
+                                               jit_type_nint);
+    jit_insn_store(fn, result, emit_int2fixnum(fn, count));
+    jit_insn_branch(fn, &endlabel);
+
+    jit_insn_label(fn, &slowlabel);
+    jit_insn_store(fn, result, emit_native(fn, "native_count", (void *)native_count,
+                                           &coll, 1, 0));
+    jit_insn_label(fn, &endlabel);
+    return result;
+}
+
+/**
+ * Emits a call to a native primitive that takes and returns imp objects.
+ */
+static jit_value_t emit_primitive(jit_function_t fn, imp_object env,
+                                  imp_object form, imp_object *enclosed,
+                                  void *native, int arity) {
+    if (imp_count(imp_rest(form)) != arity)
+        die("wrong number of arguments to primitive");
+    jit_value_t *args = malloc(sizeof(jit_value_t) * arity);
+    int i = 0;
+    for (imp_object it = imp_rest(form); it != NULL; it = imp_rest(it)) {
+        args[i++] = emit_local(fn, jit_type_void_ptr,
+                               compile(env, fn, imp_first(it), enclosed));
+    }
+    return emit_native(fn, imp_symbol_cstr(imp_first(form)), native,
+                       args, arity, 0);
+}
+
 static jit_value_t emit_if(jit_function_t fn, imp_object env,
                            imp_object form, imp_object *enclosed) {
     jit_label_t falselabel = jit_label_undefined;
@@ -293,6 +476,28 @@ jit_value_t compile(imp_object env, jit_function_t fn, imp_object form, imp_obje
                 return emit_let(fn, env, form, enclosed);
             } else if (!strcmp(fname, "fn")) { // (fn (x 2) ...)
                 return emit_fn(fn, env, form, enclosed);
+            } else if (!strcmp(fname, "vector")) { // (vector 1 2 3)
+                return emit_vector(fn, env, form, enclosed);
+            } else if (!strcmp(fname, "ivector")) { // (ivector 1 2 3)
+                return emit_vector(fn, env, form, enclosed);
+            } else if (!strcmp(fname, "nth")) { // (nth v 0)
+                return emit_nth(fn, env, form, enclosed);
+            } else if (!strcmp(fname, "count")) { // (count v)
+                return emit_count(fn, env, form, enclosed);
+            } else if (!strcmp(fname, "range")) { // (range 10)
+                return emit_primitive(fn, env, form, enclosed, (void *)imp_vector_range, 1);
+            } else if (!strcmp(fname, "sum")) { // (sum v)
+                return emit_primitive(fn, env, form, enclosed, (void *)imp_vector_sum, 1);
+            } else if (!strcmp(fname, "map-add")) { // (map-add v 1)
+                return emit_primitive(fn, env, form, enclosed, (void *)imp_vector_map_add, 2);
+            } else if (!strcmp(fname, "dot")) { // (dot v w)
+                return emit_primitive(fn, env, form, enclosed, (void *)imp_vector_dot, 2);
+            } else if (!strcmp(fname, "min")) { // (min v)
+                return emit_primitive(fn, env, form, enclosed, (void *)imp_vector_min, 1);
+            } else if (!strcmp(fname, "max")) { // (max v)
+                return emit_primitive(fn, env, form, enclosed, (void *)imp_vector_max, 1);
+            } else if (!strcmp(fname, "count-above")) { // (count-above v 5)
+                return emit_primitive(fn, env, form, enclosed, (void *)imp_vector_count_above, 2);
             }
         }
         return emit_application(fn, env, form, enclosed);
@@ -328,6 +533,9 @@ int main (int argc, char *argv[]) {
         debug = 1;
     }
 
+    if (debug)
+        fprintf(stderr, "vector kernels: %s\n", imp_vector_isa());
+
     jit_context_t context = jit_context_create();
     //imp_print(imp_read());
     imp_print(eval(context, imp_read()));
@@ -8,6 +8,46 @@ tests = [('2', '2'),
          ('((let (x 4) (fn (y) (+ (+ x y) 1))) 2)', '7'),
          ('(if true 1 0)', '1'),
          ('(if false 1 0)', '0'),
+         ('(vector 1 (+ 1 1) 3)', '[1 2 3]'),
+         ('(count (ivector 4 5 6))', '3'),
+         ('(nth (vector 4 5 6) 1)', '5'),
+         ('(nth (ivector 4 5 6) 2)', '6'),
+         ('(sum (range 100))', '4950'),
+         ('(map-add (ivector 1 2 3) 10)', '[11 12 13]'),
+         ('(dot (range 100) (range 100))', '328350'),
+         ('(min (vector 5 2 9))', '2'),
+         ('(max (ivector 5 2 9))', '9'),
+         ('(count-above (range 10) 6)', '3'),
+         ('(vector)', '[]'),
+         ('(count (ivector))', '0'),
+         ('(sum (ivector))', '0'),
+         ('(ivector (- 0 3) 4)', '[-3 4]'),
+         ('(nth (ivector 4 (- 0 5)) 1)', '-5'),
+         ('(map-add (ivector 1 2 3) (- 0 5))', '[-4 -3 -2]'),
+         ('(map-add (vector 1 2 3) (- 0 5))', '[-4 -3 -2]'),
+         ('(sum (map-add (range 37) (- 0 20)))', '-74'),
+         ('(min (map-add (range 37) (- 0 20)))', '-20'),
+         ('(max (map-add (range 37) (- 0 20)))', '16'),
+         ('(count-above (range 37) 30)', '6'),
+         ('(dot (vector 1 2 3) (ivector 4 5 6))', '32'),
+         ('(vector (nth (ivector 7 8) 0) (if false 1 2))', '[7 2]'),
+         ('(ivector (if true 1 2) (nth (vector 5 6) 1))', '[1 6]'),
+         ('(count (vector (count (ivector 1 2)) (nth (vector 3) 0)))', '2'),
+         ('(map-add (range 3) (nth (ivector 10 20) 1))', '[20 21 22]'),
+         ('(dot (ivector (if true 1 0) 2) (vector 3 (count (range 4))))', '11'),
+         ('(map-add (ivector 4611686018427387903) 1)', '[-4611686018427387904]'),
+         ('(max (map-add (ivector 4611686018427387903) 1))', '-4611686018427387904'),
+         ('(count-above (map-add (ivector 4611686018427387903) 1) 0)', '0'),
+         ('(count-above (map-add (vector 4611686018427387903) 1) 0)', '0'),
+]
+
+# forms that should abort with a message on stderr
+errors = [('(nth (ivector 4 5 6) 3)', 'nth out of bound: 3 > 3'),
+          ('(nth (vector 4 5 6) (- 0 1))', 'nth out of bound: -1 > 3'),
+          ('(min (vector))', 'min: empty vector'),
+          ('(count 5)', 'count: not a collection'),
+          ('(nth true 0)', 'nth: not a collection'),
+          ('(range 2305843009213693952)', 'range: cannot allocate 2305843009213693952 items'),
 ]
 
 for code, expected in tests:
@@ -16,3 +56,10 @@ for code, expected in tests:
     if expected != stdout.strip():
         print 'Test failure', code
         print 'Expected', expected, ' but got', stdout.replace('\n','\n> ')
+
+for code, expected in errors:
+    p = Popen(["./imp"], stdin=PIPE, stdout=PIPE, stderr=PIPE)
+    stdout, stderr = p.communicate(code)
+    if p.returncode == 0 or expected != stderr.strip():
+        print 'Test failure', code
+        print 'Expected error', expected, ' but got', stderr.replace('\n','\n> ')
@@ -1,6 +1,7 @@
 /*-*- Mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*-*/
 #include <assert.h>
 #include <ctype.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -50,7 +51,7 @@ imp_object imp_pointer(void *value) {
 }
 
 imp_object imp_fixnum(int64_t value) {
-    return (imp_object) ((value << 1) | 1);
+    return (imp_object) (((uint64_t)value << 1) | 1);
 }
 
 int imp_is_fixnum(imp_object x) {
@@ -86,6 +87,38 @@ imp_object imp_pair(imp_object x, imp_object y) {
     return imp_cons(x, imp_cons(y, NULL));
 }
 
+/**
+ * Allocates a zeroed vector or ivector, returning NULL if count items
+ * can't be allocated. Both share a layout so the size is the same.
+ */
+static imp_object alloc_vector(imp_object_type type, int64_t count) {
+    size_t header = offsetof(imp_object_struct, fields.vector.items);
+    assert(count >= 0);
+    if ((uint64_t)count > (SIZE_MAX - header) / sizeof(imp_object)) {
+        return NULL;
+    }
+    imp_object vector = calloc(1, header + sizeof(imp_object) * count);
+    if (vector == NULL) {
+        return NULL;
+    }
+    vector->type = type;
+    vector->fields.vector.count = count;
+    return vector;
+}
+
+imp_object imp_vector(int64_t count) {
+    return alloc_vector(VECTOR, count);
+}
+
+imp_object imp_ivector(int64_t count) {
+    return alloc_vector(IVECTOR, count);
+}
+
+int imp_is_vector(imp_object x) {
+    imp_object_type type = imp_type_of(x);
+    return type == VECTOR || type == IVECTOR;
+}
+
 imp_object imp_first(imp_object list) {
     assert(list->type = CONS);
     return list->fields.cons.head;
@@ -104,20 +137,42 @@ imp_object imp_third(imp_object list) {
     return imp_first(imp_rest(imp_rest(list)));
 }
 
-imp_object imp_nth(imp_object list, int n) {
-    int i;
+imp_object imp_nth(imp_object list, int64_t n) {
+    if (imp_is_vector(list)) {
+        int64_t count = list->fields.vector.count;
+        if (n < 0 || n >= count) {
+            fprintf(stderr, "nth out of bound: %ld > %ld\n", n, count);
+            abort();
+        }
+        if (list->type == IVECTOR) {
+            return imp_fixnum(list->fields.ivector.items[n]);
+        }
+        return list->fields.vector.items[n];
+    }
+    if (imp_type_of(list) != CONS && imp_type_of(list) != NIL) {
+        fprintf(stderr, "nth: not a collection\n");
+        abort();
+    }
+    int64_t i;
     for (i = 0; list; i++) {
         if (i == n) {
             return imp_first(list);            
         }
         list = imp_rest(list);
     }
-    fprintf(stderr, "nth out of bound: %d > %d\n", n, i);
+    fprintf(stderr, "nth out of bound: %ld > %ld\n", n, i);
     abort();
 }
 
-int imp_count(imp_object list) {
-    int n = 0;
+int64_t imp_count(imp_object list) {
+    if (imp_is_vector(list)) {
+        return list->fields.vector.count;
+    }
+    if (imp_type_of(list) != CONS && imp_type_of(list) != NIL) {
+        fprintf(stderr, "count: not a collection\n");
+        abort();
+    }
+    int64_t n = 0;
     while (list != NULL) {
         n++;
         list = imp_rest(list);
@@ -139,6 +194,18 @@ int imp_equals(imp_object x, imp_object y) {
     case CHARACTER: return x->fields.character == y->fields.character;
     case SYMBOL: return !strcmp(x->fields.symbol.name, y->fields.symbol.name);
     case CONS: return imp_equals(imp_first(x), imp_first(y)) && imp_equals(imp_rest(x), imp_rest(y));
+    case VECTOR:
+        if (x->fields.vector.count != y->fields.vector.count)
+            return 0;
+        for (int64_t i = 0; i < x->fields.vector.count; i++) {
+            if (!imp_equals(x->fields.vector.items[i], y->fields.vector.items[i]))
+                return 0;
+        }
+        return 1;
+    case IVECTOR:
+        return x->fields.ivector.count == y->fields.ivector.count &&
+            !memcmp(x->fields.ivector.items, y->fields.ivector.items,
+                    sizeof(int64_t) * x->fields.ivector.count);
     case NIL:
     case BOOLEAN:
     case FN: return x == y;
@@ -213,6 +280,21 @@ void imp_print(imp_object object) {
         }
         printf(")");
         break;
+    case VECTOR:
+        printf("[");
+        for (int64_t i = 0; i < object->fields.vector.count; i++) {
+            if (i > 0) printf(" ");
+            imp_print(object->fields.vector.items[i]);
+        }
+        printf("]");
+        break;
+    case IVECTOR:
+        printf("[");
+        for (int64_t i = 0; i < object->fields.ivector.count; i++) {
+            printf(i > 0 ? " %ld" : "%ld", object->fields.ivector.items[i]);
+        }
+        printf("]");
+        break;
     case FN:
         printf("#fn {:entrypoint %p :arity %d}", object->fields.fn.entrypoint,
                object->fields.fn.arity);
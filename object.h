@@ -6,6 +6,8 @@ typedef enum {
     CHARACTER,
     SYMBOL,
     CONS,
+    VECTOR,
+    IVECTOR,
     NUMBER,
     FIXNUM,
     POINTER,
@@ -28,6 +30,16 @@ typedef struct imp_object_struct {
             imp_object head;
             imp_object tail;
         } cons;
+        // vector and ivector share a layout so that compiled code can
+        // load the count and elements without knowing which it has
+        struct {
+            int64_t count;
+            imp_object items[];
+        } vector;
+        struct {
+            int64_t count;
+            int64_t items[];
+        } ivector;
         void *pointer;
         struct {
             void *entrypoint;
@@ -37,6 +49,9 @@ typedef struct imp_object_struct {
     } fields;
 } imp_object_struct;
 
+_Static_assert(sizeof(imp_object) == sizeof(int64_t),
+               "vector and ivector items must have the same size");
+
 imp_object imp_symbol(const char *name);
 imp_object imp_number(int64_t value);
 imp_object imp_pointer(void *value);
@@ -46,12 +61,15 @@ int64_t    imp_cint(imp_object x);
 imp_object_type imp_type_of(imp_object object);
 imp_object imp_cons(imp_object head, imp_object tail);
 imp_object imp_pair(imp_object x, imp_object y);
+imp_object imp_vector(int64_t count);
+imp_object imp_ivector(int64_t count);
+int        imp_is_vector(imp_object x);
 imp_object imp_first(imp_object list);
 imp_object imp_rest(imp_object list);
 imp_object imp_second(imp_object list);
 imp_object imp_third(imp_object list);
-imp_object imp_nth(imp_object list, int n);
-int        imp_count(imp_object list);
+imp_object imp_nth(imp_object list, int64_t n);
+int64_t    imp_count(imp_object list);
 int        imp_equals(imp_object x, imp_object y);
 void       imp_print(imp_object object);
 imp_object imp_read();
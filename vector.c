@@ -0,0 +1,444 @@
+/*-*- Mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*-*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "object.h"
+#include "vector.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+/*
+ * Kernels operate on raw int64 arrays. Arithmetic wraps, so it is done
+ * unsigned in the scalar versions. Callers guarantee n > 0 for min and
+ * max.
+ *
+ * Ivector elements must stay within fixnum range so they agree with
+ * boxed vectors, so add wraps its results to 63 bits like imp_fixnum.
+ * Reductions are wrapped when their result is boxed.
+ */
+typedef struct {
+    const char *name;
+    int64_t (*sum)(const int64_t *xs, int64_t n);
+    void    (*add)(int64_t *out, const int64_t *xs, int64_t n, int64_t k);
+    int64_t (*dot)(const int64_t *xs, const int64_t *ys, int64_t n);
+    int64_t (*min)(const int64_t *xs, int64_t n);
+    int64_t (*max)(const int64_t *xs, int64_t n);
+    int64_t (*count_above)(const int64_t *xs, int64_t n, int64_t k);
+} kernels;
+
+static int64_t sum_scalar(const int64_t *xs, int64_t n) {
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < n; i++)
+        sum += xs[i];
+    return sum;
+}
+
+static int64_t wrap63(uint64_t x) {
+    return (int64_t)(x << 1) >> 1;
+}
+
+static void add_scalar(int64_t *out, const int64_t *xs, int64_t n, int64_t k) {
+    for (int64_t i = 0; i < n; i++)
+        out[i] = wrap63((uint64_t)xs[i] + k);
+}
+
+static int64_t dot_scalar(const int64_t *xs, const int64_t *ys, int64_t n) {
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < n; i++)
+        sum += (uint64_t)xs[i] * ys[i];
+    return sum;
+}
+
+static int64_t min_scalar(const int64_t *xs, int64_t n) {
+    int64_t best = xs[0];
+    for (int64_t i = 1; i < n; i++)
+        if (xs[i] < best) best = xs[i];
+    return best;
+}
+
+static int64_t max_scalar(const int64_t *xs, int64_t n) {
+    int64_t best = xs[0];
+    for (int64_t i = 1; i < n; i++)
+        if (xs[i] > best) best = xs[i];
+    return best;
+}
+
+static int64_t count_above_scalar(const int64_t *xs, int64_t n, int64_t k) {
+    int64_t count = 0;
+    for (int64_t i = 0; i < n; i++)
+        count += xs[i] > k;
+    return count;
+}
+
+static const kernels scalar_kernels = {
+    "scalar", sum_scalar, add_scalar, dot_scalar,
+    min_scalar, max_scalar, count_above_scalar,
+};
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * SSE4.2 kernels, two lanes wide. SSE4.2 is the baseline here because
+ * 64-bit compares (pcmpgtq) only arrived with it.
+ */
+
+#define SSE42 __attribute__((target("sse4.2")))
+
+SSE42 static int64_t sum_sse42(const int64_t *xs, int64_t n) {
+    __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_epi64(acc0, _mm_loadu_si128((const __m128i *)(xs + i)));
+        acc1 = _mm_add_epi64(acc1, _mm_loadu_si128((const __m128i *)(xs + i + 2)));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+    return (uint64_t)lanes[0] + lanes[1] + sum_scalar(xs + i, n - i);
+}
+
+// sign extend from bit 62: there is no 64-bit arithmetic shift before AVX-512
+SSE42 static inline __m128i wrap63_sse42(__m128i x) {
+    __m128i low = _mm_and_si128(x, _mm_set1_epi64x(INT64_MAX));
+    __m128i sign = _mm_set1_epi64x(INT64_C(1) << 62);
+    return _mm_sub_epi64(_mm_xor_si128(low, sign), sign);
+}
+
+SSE42 static void add_sse42(int64_t *out, const int64_t *xs, int64_t n, int64_t k) {
+    __m128i kv = _mm_set1_epi64x(k);
+    int64_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(xs + i));
+        _mm_storeu_si128((__m128i *)(out + i), wrap63_sse42(_mm_add_epi64(x, kv)));
+    }
+    add_scalar(out + i, xs + i, n - i, k);
+}
+
+// low 64 bits of a 64x64 multiply built from 32x32->64 multiplies
+SSE42 static inline __m128i mul64_sse42(__m128i a, __m128i b) {
+    __m128i lo = _mm_mul_epu32(a, b);
+    __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b),
+                                  _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+    return _mm_add_epi64(lo, _mm_slli_epi64(cross, 32));
+}
+
+SSE42 static int64_t dot_sse42(const int64_t *xs, const int64_t *ys, int64_t n) {
+    __m128i acc = _mm_setzero_si128();
+    int64_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(xs + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(ys + i));
+        acc = _mm_add_epi64(acc, mul64_sse42(x, y));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return (uint64_t)lanes[0] + lanes[1] + dot_scalar(xs + i, ys + i, n - i);
+}
+
+SSE42 static int64_t min_sse42(const int64_t *xs, int64_t n) {
+    __m128i best = _mm_set1_epi64x(xs[0]);
+    int64_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(xs + i));
+        best = _mm_blendv_epi8(best, x, _mm_cmpgt_epi64(best, x));
+    }
+    int64_t lanes[3];
+    _mm_storeu_si128((__m128i *)lanes, best);
+    lanes[2] = i < n ? min_scalar(xs + i, n - i) : lanes[0];
+    return min_scalar(lanes, 3);
+}
+
+SSE42 static int64_t max_sse42(const int64_t *xs, int64_t n) {
+    __m128i best = _mm_set1_epi64x(xs[0]);
+    int64_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(xs + i));
+        best = _mm_blendv_epi8(best, x, _mm_cmpgt_epi64(x, best));
+    }
+    int64_t lanes[3];
+    _mm_storeu_si128((__m128i *)lanes, best);
+    lanes[2] = i < n ? max_scalar(xs + i, n - i) : lanes[0];
+    return max_scalar(lanes, 3);
+}
+
+SSE42 static int64_t count_above_sse42(const int64_t *xs, int64_t n, int64_t k) {
+    __m128i kv = _mm_set1_epi64x(k);
+    __m128i acc = _mm_setzero_si128();
+    int64_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(xs + i));
+        // true lanes are -1, so subtracting counts them
+        acc = _mm_sub_epi64(acc, _mm_cmpgt_epi64(x, kv));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] + count_above_scalar(xs + i, n - i, k);
+}
+
+static const kernels sse42_kernels = {
+    "sse4.2", sum_sse42, add_sse42, dot_sse42,
+    min_sse42, max_sse42, count_above_sse42,
+};
+
+/*
+ * AVX2 kernels, four lanes wide. Same shape as the SSE4.2 ones.
+ */
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static int64_t sum_avx2(const int64_t *xs, int64_t n) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    int64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_loadu_si256((const __m256i *)(xs + i)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_loadu_si256((const __m256i *)(xs + i + 4)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+    return (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3]
+        + sum_scalar(xs + i, n - i);
+}
+
+AVX2 static inline __m256i wrap63_avx2(__m256i x) {
+    __m256i low = _mm256_and_si256(x, _mm256_set1_epi64x(INT64_MAX));
+    __m256i sign = _mm256_set1_epi64x(INT64_C(1) << 62);
+    return _mm256_sub_epi64(_mm256_xor_si256(low, sign), sign);
+}
+
+AVX2 static void add_avx2(int64_t *out, const int64_t *xs, int64_t n, int64_t k) {
+    __m256i kv = _mm256_set1_epi64x(k);
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(xs + i));
+        _mm256_storeu_si256((__m256i *)(out + i), wrap63_avx2(_mm256_add_epi64(x, kv)));
+    }
+    add_scalar(out + i, xs + i, n - i, k);
+}
+
+AVX2 static inline __m256i mul64_avx2(__m256i a, __m256i b) {
+    __m256i lo = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+AVX2 static int64_t dot_avx2(const int64_t *xs, const int64_t *ys, int64_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(xs + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(ys + i));
+        acc = _mm256_add_epi64(acc, mul64_avx2(x, y));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3]
+        + dot_scalar(xs + i, ys + i, n - i);
+}
+
+AVX2 static int64_t min_avx2(const int64_t *xs, int64_t n) {
+    __m256i best = _mm256_set1_epi64x(xs[0]);
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(xs + i));
+        best = _mm256_blendv_epi8(best, x, _mm256_cmpgt_epi64(best, x));
+    }
+    int64_t lanes[5];
+    _mm256_storeu_si256((__m256i *)lanes, best);
+    lanes[4] = i < n ? min_scalar(xs + i, n - i) : lanes[0];
+    return min_scalar(lanes, 5);
+}
+
+AVX2 static int64_t max_avx2(const int64_t *xs, int64_t n) {
+    __m256i best = _mm256_set1_epi64x(xs[0]);
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(xs + i));
+        best = _mm256_blendv_epi8(best, x, _mm256_cmpgt_epi64(x, best));
+    }
+    int64_t lanes[5];
+    _mm256_storeu_si256((__m256i *)lanes, best);
+    lanes[4] = i < n ? max_scalar(xs + i, n - i) : lanes[0];
+    return max_scalar(lanes, 5);
+}
+
+AVX2 static int64_t count_above_avx2(const int64_t *xs, int64_t n, int64_t k) {
+    __m256i kv = _mm256_set1_epi64x(k);
+    __m256i acc = _mm256_setzero_si256();
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(xs + i));
+        acc = _mm256_sub_epi64(acc, _mm256_cmpgt_epi64(x, kv));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+        + count_above_scalar(xs + i, n - i, k);
+}
+
+static const kernels avx2_kernels = {
+    "avx2", sum_avx2, add_avx2, dot_avx2,
+    min_avx2, max_avx2, count_above_avx2,
+};
+
+#endif
+
+static const kernels *active_kernels = NULL;
+
+/**
+ * Picks the widest kernel set the CPU supports, on first use.
+ */
+static const kernels *kern() {
+    if (active_kernels == NULL) {
+        active_kernels = &scalar_kernels;
+#ifdef HAVE_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            active_kernels = &avx2_kernels;
+        } else if (__builtin_cpu_supports("sse4.2")) {
+            active_kernels = &sse42_kernels;
+        }
+#endif
+    }
+    return active_kernels;
+}
+
+const char *imp_vector_isa() {
+    return kern()->name;
+}
+
+/**
+ * Returns the count of v, which must be a vector or ivector.
+ */
+static int64_t vector_count(imp_object v, const char *op) {
+    if (!imp_is_vector(v)) {
+        fprintf(stderr, "%s: not a vector\n", op);
+        abort();
+    }
+    return v->fields.vector.count;
+}
+
+static imp_object alloc_result(imp_object_type type, int64_t count,
+                               const char *op) {
+    imp_object result = type == IVECTOR ? imp_ivector(count) : imp_vector(count);
+    if (result == NULL) {
+        fprintf(stderr, "%s: cannot allocate %ld items\n", op, count);
+        abort();
+    }
+    return result;
+}
+
+static int64_t item(imp_object v, int64_t i) {
+    if (v->type == IVECTOR) {
+        return v->fields.ivector.items[i];
+    }
+    return imp_cint(v->fields.vector.items[i]);
+}
+
+imp_object imp_vector_range(imp_object n) {
+    int64_t count = imp_cint(n);
+    if (count < 0) {
+        fprintf(stderr, "range: negative count %ld\n", count);
+        abort();
+    }
+    imp_object iv = alloc_result(IVECTOR, count, "range");
+    for (int64_t i = 0; i < count; i++) {
+        iv->fields.ivector.items[i] = i;
+    }
+    return iv;
+}
+
+/*
+ * Ivectors go to the kernels. Boxed vectors are read in place a fixnum
+ * at a time.
+ */
+
+imp_object imp_vector_sum(imp_object v) {
+    int64_t n = vector_count(v, "sum");
+    if (v->type == IVECTOR) {
+        return imp_fixnum(kern()->sum(v->fields.ivector.items, n));
+    }
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < n; i++)
+        sum += imp_cint(v->fields.vector.items[i]);
+    return imp_fixnum(sum);
+}
+
+/**
+ * Adds x to every element, returning a new vector of the same kind as v.
+ */
+imp_object imp_vector_map_add(imp_object v, imp_object x) {
+    int64_t n = vector_count(v, "map-add");
+    int64_t k = imp_cint(x);
+    if (v->type == IVECTOR) {
+        imp_object result = alloc_result(IVECTOR, n, "map-add");
+        kern()->add(result->fields.ivector.items, v->fields.ivector.items, n, k);
+        return result;
+    }
+    imp_object result = alloc_result(VECTOR, n, "map-add");
+    for (int64_t i = 0; i < n; i++) {
+        uint64_t sum = (uint64_t)imp_cint(v->fields.vector.items[i]) + k;
+        result->fields.vector.items[i] = imp_fixnum(sum);
+    }
+    return result;
+}
+
+imp_object imp_vector_dot(imp_object v, imp_object w) {
+    int64_t n = vector_count(v, "dot");
+    if (n != vector_count(w, "dot")) {
+        fprintf(stderr, "dot: length mismatch %ld != %ld\n", n, w->fields.vector.count);
+        abort();
+    }
+    if (v->type == IVECTOR && w->type == IVECTOR) {
+        return imp_fixnum(kern()->dot(v->fields.ivector.items,
+                                      w->fields.ivector.items, n));
+    }
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < n; i++)
+        sum += (uint64_t)item(v, i) * item(w, i);
+    return imp_fixnum(sum);
+}
+
+imp_object imp_vector_min(imp_object v) {
+    int64_t n = vector_count(v, "min");
+    if (n == 0) {
+        fprintf(stderr, "min: empty vector\n");
+        abort();
+    }
+    if (v->type == IVECTOR) {
+        return imp_fixnum(kern()->min(v->fields.ivector.items, n));
+    }
+    int64_t best = item(v, 0);
+    for (int64_t i = 1; i < n; i++)
+        if (item(v, i) < best) best = item(v, i);
+    return imp_fixnum(best);
+}
+
+imp_object imp_vector_max(imp_object v) {
+    int64_t n = vector_count(v, "max");
+    if (n == 0) {
+        fprintf(stderr, "max: empty vector\n");
+        abort();
+    }
+    if (v->type == IVECTOR) {
+        return imp_fixnum(kern()->max(v->fields.ivector.items, n));
+    }
+    int64_t best = item(v, 0);
+    for (int64_t i = 1; i < n; i++)
+        if (item(v, i) > best) best = item(v, i);
+    return imp_fixnum(best);
+}
+
+imp_object imp_vector_count_above(imp_object v, imp_object x) {
+    int64_t n = vector_count(v, "count-above");
+    int64_t k = imp_cint(x);
+    if (v->type == IVECTOR) {
+        return imp_fixnum(kern()->count_above(v->fields.ivector.items, n, k));
+    }
+    int64_t count = 0;
+    for (int64_t i = 0; i < n; i++)
+        count += imp_cint(v->fields.vector.items[i]) > k;
+    return imp_fixnum(count);
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "object.h"
+
+/*
+ * Bulk numeric primitives over vectors. Each takes and returns imp
+ * objects so that compiled code can call them directly. Ivectors go
+ * through SIMD kernels picked at runtime for the host CPU. Boxed vectors
+ * are read in place by scalar loops.
+ */
+imp_object imp_vector_range(imp_object n);
+imp_object imp_vector_sum(imp_object v);
+imp_object imp_vector_map_add(imp_object v, imp_object x);
+imp_object imp_vector_dot(imp_object v, imp_object w);
+imp_object imp_vector_min(imp_object v);
+imp_object imp_vector_max(imp_object v);
+imp_object imp_vector_count_above(imp_object v, imp_object x);
+const char *imp_vector_isa();